@@ -0,0 +1,161 @@
+#pragma once
+#include "function.h"
+#include <cstdint>
+
+// Hot-swappable callback slot with wait-free readers. The slot packs the
+// control-block pointer and an acquisition counter into a single word
+// (differential reference counting): a reader pins the current target with
+// one fetch_add and never loops, spins or blocks; store() exchanges the
+// word and folds the accumulated acquisitions into the block's internal
+// count. The last reference out, reader or writer, frees the block.
+template <typename F, size_t Capacity = sizeof(void*),
+          size_t Align = alignof(void*)>
+struct atomic_function;
+
+template <typename R, typename... Args, size_t Capacity, size_t Align>
+struct atomic_function<R(Args...), Capacity, Align> {
+  // The acquisition counter lives in the upper bits of the slot word, which
+  // requires pointers to fit 48 bits as on mainstream x86-64 and AArch64.
+  static_assert(sizeof(void*) == 8,
+                "atomic_function requires 64-bit pointers");
+
+  using function_t = function<R(Args...), Capacity, Align>;
+
+private:
+  struct block {
+    explicit block(function_t f) : value(std::move(f)) {}
+
+    // Internal count, offset by `bias` while the slot owns the block so
+    // that reader releases of not-yet-reconciled acquisitions can never
+    // drive it to zero early.
+    std::atomic<std::ptrdiff_t> refs{bias};
+    function_t value;
+  };
+
+public:
+  struct snapshot {
+    snapshot(snapshot&& other) noexcept
+        : b(std::exchange(other.b, nullptr)) {}
+
+    snapshot(snapshot const&) = delete;
+    snapshot& operator=(snapshot const&) = delete;
+
+    ~snapshot() {
+      if (b != nullptr) {
+        release(b);
+      }
+    }
+
+    function_t const& operator*() const noexcept {
+      return b->value;
+    }
+
+    explicit operator bool() const noexcept {
+      return b != nullptr;
+    }
+
+  private:
+    friend atomic_function;
+
+    explicit snapshot(block* b) noexcept : b(b) {}
+
+    block* b;
+  };
+
+  atomic_function() noexcept = default;
+
+  atomic_function(function_t f) : slot(pack(new block(std::move(f)), 0)) {}
+
+  atomic_function(atomic_function const&) = delete;
+  atomic_function& operator=(atomic_function const&) = delete;
+
+  ~atomic_function() {
+    drop(slot.load(std::memory_order_relaxed));
+  }
+
+  void store(function_t f) {
+    uintptr_t next = pack(new block(std::move(f)), 0);
+    drop(slot.exchange(next, std::memory_order_acq_rel));
+  }
+
+  snapshot load() const noexcept {
+    return snapshot(acquire());
+  }
+
+  R operator()(Args... args) const {
+    snapshot guard(acquire());
+    if (!guard) {
+      throw bad_function_call{};
+    }
+    return (*guard)(std::forward<Args>(args)...);
+  }
+
+  explicit operator bool() const noexcept {
+    snapshot guard(acquire());
+    return guard && static_cast<bool>(*guard);
+  }
+
+private:
+  constexpr static unsigned count_shift = 48;
+  constexpr static uintptr_t one_reader = uintptr_t(1) << count_shift;
+  constexpr static uintptr_t ptr_mask = one_reader - 1;
+  constexpr static uintptr_t reconcile_at = uintptr_t(1) << 15;
+  constexpr static std::ptrdiff_t bias = std::ptrdiff_t(1) << 32;
+
+  static block* ptr_of(uintptr_t word) noexcept {
+    return reinterpret_cast<block*>(word & ptr_mask);
+  }
+
+  static uintptr_t count_of(uintptr_t word) noexcept {
+    return word >> count_shift;
+  }
+
+  static uintptr_t pack(block* b, uintptr_t count) noexcept {
+    return reinterpret_cast<uintptr_t>(b) | (count << count_shift);
+  }
+
+  block* acquire() const noexcept {
+    uintptr_t word = slot.fetch_add(one_reader, std::memory_order_acquire);
+    block* b = ptr_of(word);
+    if (b == nullptr) {
+      // The stray count on an empty slot is discarded by the next store.
+      return nullptr;
+    }
+
+    uintptr_t count = count_of(word) + 1;
+    if (count >= reconcile_at) {
+      // Fold the acquisitions into the block before the counter can reach
+      // the pointer bits; losing the race means someone else folded or the
+      // slot was swapped, either way the count stays accounted for.
+      uintptr_t expected = pack(b, count);
+      if (slot.compare_exchange_strong(expected, pack(b, 0),
+                                       std::memory_order_relaxed)) {
+        b->refs.fetch_add(static_cast<std::ptrdiff_t>(count),
+                          std::memory_order_relaxed);
+      }
+    }
+    return b;
+  }
+
+  static void release(block* b) noexcept {
+    if (b->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete b;
+    }
+  }
+
+  // Retires a word taken out of the slot: credit the acquisitions it
+  // accumulated, debit the slot's own biased reference.
+  static void drop(uintptr_t word) noexcept {
+    block* b = ptr_of(word);
+    if (b == nullptr) {
+      return;
+    }
+
+    std::ptrdiff_t delta = static_cast<std::ptrdiff_t>(count_of(word)) - bias;
+    if (b->refs.fetch_add(delta, std::memory_order_acq_rel) == -delta) {
+      delete b;
+    }
+  }
+
+  mutable std::atomic<uintptr_t> slot{0};
+};
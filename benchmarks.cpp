@@ -0,0 +1,117 @@
+#include "function.h"
+#include <benchmark/benchmark.h>
+#include <functional>
+
+namespace {
+struct small_target {
+  int value;
+
+  int operator()() const {
+    return value;
+  }
+};
+
+struct large_target {
+  large_target(int value) noexcept : value(value) {}
+
+  int operator()() const {
+    return value;
+  }
+
+  int value;
+  int payload[1000]{};
+};
+
+void construct_destroy_small(benchmark::State& state) {
+  for (auto _ : state) {
+    function<int()> f = small_target{42};
+    benchmark::DoNotOptimize(f);
+  }
+}
+
+void construct_destroy_large(benchmark::State& state) {
+  for (auto _ : state) {
+    function<int()> f = large_target(42);
+    benchmark::DoNotOptimize(f);
+  }
+}
+
+void copy_assign_small(benchmark::State& state) {
+  function<int()> f = small_target{42};
+  function<int()> g;
+  for (auto _ : state) {
+    g = f;
+    benchmark::DoNotOptimize(g);
+  }
+}
+
+void copy_assign_large(benchmark::State& state) {
+  function<int()> f = large_target(42);
+  function<int()> g;
+  for (auto _ : state) {
+    g = f;
+    benchmark::DoNotOptimize(g);
+  }
+}
+
+void move_assign_small(benchmark::State& state) {
+  function<int()> f = small_target{42};
+  function<int()> g;
+  for (auto _ : state) {
+    g = std::move(f);
+    f = std::move(g);
+    benchmark::DoNotOptimize(f);
+  }
+}
+
+void move_assign_large(benchmark::State& state) {
+  function<int()> f = large_target(42);
+  function<int()> g;
+  for (auto _ : state) {
+    g = std::move(f);
+    f = std::move(g);
+    benchmark::DoNotOptimize(f);
+  }
+}
+
+void invoke_small(benchmark::State& state) {
+  function<int()> f = small_target{42};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(f());
+  }
+}
+
+void invoke_large(benchmark::State& state) {
+  function<int()> f = large_target(42);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(f());
+  }
+}
+
+void std_function_invoke_small(benchmark::State& state) {
+  std::function<int()> f = small_target{42};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(f());
+  }
+}
+
+void std_function_invoke_large(benchmark::State& state) {
+  std::function<int()> f = large_target(42);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(f());
+  }
+}
+
+BENCHMARK(construct_destroy_small);
+BENCHMARK(construct_destroy_large);
+BENCHMARK(copy_assign_small);
+BENCHMARK(copy_assign_large);
+BENCHMARK(move_assign_small);
+BENCHMARK(move_assign_large);
+BENCHMARK(invoke_small);
+BENCHMARK(invoke_large);
+BENCHMARK(std_function_invoke_small);
+BENCHMARK(std_function_invoke_large);
+} // namespace
+
+BENCHMARK_MAIN();
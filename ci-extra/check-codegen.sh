@@ -0,0 +1,33 @@
+#!/bin/sh
+# Codegen regression checks for function.h, driven by the
+# function-codegen-test target:
+#   1. the small-path object must not reference operator new/delete;
+#   2. the many-targets object's text size must stay within its budget.
+set -eu
+
+small_obj="$1"
+many_obj="$2"
+text_budget="$3"
+
+# The deleting destructor of bad_function_call is the one place operator
+# delete may legitimately appear: it belongs to the exception's vtable, not
+# to any target allocation path.
+if ! objdump -dr "$small_obj" | awk '
+    /^Disassembly of section/ { section = $NF }
+    /_Znw|_Zna|_Zdl|_Zda/ && section !~ /bad_function_callD0/ {
+      print "  " section
+      bad = 1
+    }
+    END { exit bad }'; then
+  echo "error: small-path TU references operator new/delete" >&2
+  exit 1
+fi
+
+text_size=$(size -B "$many_obj" | awk 'NR == 2 { print $1 }')
+if [ "$text_size" -gt "$text_budget" ]; then
+  echo "error: many-targets text size $text_size exceeds budget $text_budget" >&2
+  exit 1
+fi
+
+echo "codegen checks passed: small path allocation-free," \
+     "many-targets text size $text_size <= $text_budget"
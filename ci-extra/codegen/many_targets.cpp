@@ -0,0 +1,21 @@
+// Instantiates function with many distinct small lambda targets; the text
+// size of this object file is the per-target footprint of get_descriptor
+// and the thunks. ci-extra/check-codegen.sh fails the build if it grows
+// past its budget, which would mean a new per-T instantiation crept into
+// the header.
+#include "function.h"
+
+template <int I>
+int invoke_one(int x) {
+  function<int(int)> f = [x](int v) { return v + x + I; };
+  return f(x);
+}
+
+template <int... Is>
+int invoke_all(int x, std::integer_sequence<int, Is...>) {
+  return (invoke_one<Is>(x) + ...);
+}
+
+int many_targets(int x) {
+  return invoke_all(x, std::make_integer_sequence<int, 32>());
+}
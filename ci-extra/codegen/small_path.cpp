@@ -0,0 +1,30 @@
+// Every target in this translation unit fits the small buffer, so the
+// object file must not reference operator new or operator delete at all;
+// ci-extra/check-codegen.sh fails the build if it does.
+#include "function.h"
+
+namespace {
+struct counter {
+  int value = 0;
+
+  int operator()(int x) noexcept {
+    value += x;
+    return value;
+  }
+};
+} // namespace
+
+int small_path(int x) {
+  function<int(int)> f = counter();
+  function<int(int)> g = f;
+  f = counter();
+  g = std::move(f);
+  swap(f, g);
+  return g(x) + (f ? f(x + 1) : 0);
+}
+
+int small_path_unique(int x) {
+  unique_function<int(int)> f = counter();
+  unique_function<int(int)> g = std::move(f);
+  return g(x);
+}
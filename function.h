@@ -1,5 +1,19 @@
 #pragma once
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <functional>
 #include <memory>
+#include <span>
+#include <tuple>
+#include <typeinfo>
+#include <utility>
+
+#ifdef FUNCTION_PROFILE
+#include <cstdio>
+#include <mutex>
+#include <vector>
+#endif
 
 struct bad_function_call : std::exception {
   const char* what() const noexcept override {
@@ -8,46 +22,227 @@ struct bad_function_call : std::exception {
 };
 
 namespace details {
-using storage_t = std::aligned_storage_t<sizeof(void*), alignof(void*)>;
+template <size_t Capacity, size_t Align>
+using storage = std::aligned_storage_t<Capacity, Align>;
 
-template <typename T>
+template <typename T, typename Storage>
 constexpr inline bool fits_small =
-    sizeof(T) < sizeof(storage_t) && alignof(storage_t) % alignof(T) == 0 &&
-    std::is_nothrow_move_assignable_v<T> &&
-    std::is_nothrow_move_constructible_v<T>;
+    sizeof(T) <= sizeof(Storage) && alignof(Storage) % alignof(T) == 0 &&
+    (std::is_trivially_copyable_v<T> ||
+     std::is_nothrow_move_constructible_v<T>);
+
+template <typename T, typename Storage>
+constexpr inline bool trivially_small =
+    fits_small<T, Storage> && std::is_trivially_copyable_v<T>;
+
+#ifdef FUNCTION_PROFILE
+struct profile_registry {
+  static profile_registry& instance() {
+    static profile_registry registry;
+    return registry;
+  }
+
+  void add(char const* name,
+           std::atomic<unsigned long long> const* counter) {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.emplace_back(name, counter);
+  }
+
+  void dump(std::FILE* out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::fprintf(out, "function profile: calls per target type\n");
+    for (auto const& [name, counter] : entries) {
+      std::fprintf(out, "%20llu  %s\n",
+                   counter->load(std::memory_order_relaxed), name);
+    }
+  }
+
+  ~profile_registry() {
+    dump(stderr);
+  }
+
+private:
+  std::mutex mutex;
+  std::vector<
+      std::pair<char const*, std::atomic<unsigned long long> const*>>
+      entries;
+};
 
 template <typename T>
-T* small_cast(storage_t& storage) {
-  return reinterpret_cast<T*>(&storage);
+struct profile_counter_t {
+  profile_counter_t() {
+    profile_registry::instance().add(typeid(T).name(), &count);
+  }
+
+  std::atomic<unsigned long long> count{0};
+};
+
+template <typename T>
+inline profile_counter_t<T> profile_counter;
+#endif
+
+template <typename T>
+constexpr inline bool stateless =
+    std::is_empty_v<T> && std::is_trivially_default_constructible_v<T> &&
+    std::is_trivially_copyable_v<T>;
+
+template <typename Storage>
+void trivial_copy(Storage const& src, Storage& dst) noexcept {
+  std::memcpy(&dst, &src, sizeof(Storage));
+}
+
+template <typename Storage>
+void trivial_move(Storage& src, Storage& dst) noexcept {
+  std::memcpy(&dst, &src, sizeof(Storage));
+}
+
+template <typename Storage>
+void trivial_destroy(Storage&) noexcept {}
+
+struct pool {
+  static void* allocate(size_t size) {
+    size_t cls = size_class(size);
+    if (cls >= n_classes) {
+      return ::operator new(size);
+    }
+
+    void*& head = free_lists().heads[cls];
+    if (head != nullptr) {
+      void* ptr = head;
+      head = *static_cast<void**>(ptr);
+      return ptr;
+    }
+    return ::operator new(class_size(cls));
+  }
+
+  static void deallocate(void* ptr, size_t size) noexcept {
+    size_t cls = size_class(size);
+    if (cls >= n_classes) {
+      ::operator delete(ptr);
+      return;
+    }
+
+    void*& head = free_lists().heads[cls];
+    *static_cast<void**>(ptr) = head;
+    head = ptr;
+  }
+
+private:
+  constexpr static size_t min_block = sizeof(void*);
+  constexpr static size_t n_classes = 10;
+
+  constexpr static size_t class_size(size_t cls) noexcept {
+    return min_block << cls;
+  }
+
+  constexpr static size_t size_class(size_t size) noexcept {
+    size_t cls = 0;
+    while (cls < n_classes && class_size(cls) < size) {
+      ++cls;
+    }
+    return cls;
+  }
+
+  struct free_list {
+    void* heads[n_classes]{};
+
+    ~free_list() {
+      for (void* head : heads) {
+        while (head != nullptr) {
+          void* next = *static_cast<void**>(head);
+          ::operator delete(head);
+          head = next;
+        }
+      }
+    }
+  };
+
+  static free_list& free_lists() noexcept {
+    thread_local free_list lists;
+    return lists;
+  }
+};
+
+template <typename T, typename... As>
+T* big_new(As&&... as) {
+  void* mem;
+  if constexpr (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+    mem = ::operator new(sizeof(T), std::align_val_t(alignof(T)));
+  } else {
+    mem = pool::allocate(sizeof(T));
+  }
+
+  try {
+    return new (mem) T(std::forward<As>(as)...);
+  } catch (...) {
+    if constexpr (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+      ::operator delete(mem, std::align_val_t(alignof(T)));
+    } else {
+      pool::deallocate(mem, sizeof(T));
+    }
+    throw;
+  }
 }
 
 template <typename T>
-T const* small_cast(storage_t const& storage) {
-  return reinterpret_cast<T const*>(&storage);
+void big_delete(T* ptr) noexcept {
+  ptr->~T();
+  if constexpr (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+    ::operator delete(ptr, std::align_val_t(alignof(T)));
+  } else {
+    pool::deallocate(ptr, sizeof(T));
+  }
 }
 
 template <typename T>
-T* big_cast(storage_t& storage) {
+struct shared_target {
+  explicit shared_target(T val) : value(std::move(val)) {}
+
+  std::atomic<size_t> refs{1};
+  T value;
+};
+
+template <typename T>
+void* erase_address(T& val) noexcept {
+  if constexpr (std::is_function_v<T>) {
+    return reinterpret_cast<void*>(&val);
+  } else {
+    return const_cast<void*>(static_cast<void const*>(std::addressof(val)));
+  }
+}
+
+template <typename T, typename Storage>
+T* small_cast(Storage& storage) {
+  return reinterpret_cast<T*>(&storage);
+}
+
+template <typename T, typename Storage>
+T const* small_cast(Storage const& storage) {
+  return reinterpret_cast<T const*>(&storage);
+}
+
+template <typename T, typename Storage>
+T* big_cast(Storage& storage) {
   return *reinterpret_cast<T**>(&storage);
 }
 
-template <typename T>
-T* big_cast(storage_t const& storage) {
+template <typename T, typename Storage>
+T* big_cast(Storage const& storage) {
   return *reinterpret_cast<T* const*>(&storage);
 }
 
-template <typename T>
-T* cast(storage_t& storage) {
-  if constexpr (fits_small<T>) {
+template <typename T, typename Storage>
+T* cast(Storage& storage) {
+  if constexpr (fits_small<T, Storage>) {
     return small_cast<T>(storage);
   } else {
     return big_cast<T>(storage);
   }
 }
 
-template <typename T>
-T const* cast(storage_t const& storage) {
-  if constexpr (fits_small<T>) {
+template <typename T, typename Storage>
+T const* cast(Storage const& storage) {
+  if constexpr (fits_small<T, Storage>) {
     return small_cast<T>(storage);
   } else {
     return big_cast<T>(storage);
@@ -55,125 +250,491 @@ T const* cast(storage_t const& storage) {
 }
 } // namespace details
 
-template <typename R, typename... Args>
-struct type_descriptor {
+namespace details {
+template <typename Storage>
+struct storage_manager {
+  void (*copy)(Storage const& src, Storage& dst);
+  void (*move)(Storage& src, Storage& dst);
+  void (*destroy)(Storage& src);
+};
+
+template <typename T, typename Storage, bool Copyable>
+constexpr auto get_copy_thunk() noexcept -> void (*)(Storage const&,
+                                                     Storage&) {
+  if constexpr (!Copyable) {
+    return nullptr;
+  } else if constexpr (trivially_small<T, Storage>) {
+    return &trivial_copy<Storage>;
+  } else {
+    return [](Storage const& src, Storage& dst) {
+      if constexpr (fits_small<T, Storage>) {
+        new (&dst) T(*small_cast<T>(src));
+      } else {
+        auto ptr = big_new<T>(*big_cast<T>(src));
+        new (&dst) T*(ptr);
+      }
+    };
+  }
+}
 
-  void (*copy)(details::storage_t const& src, details::storage_t& dst);
-  void (*move)(details::storage_t& src, details::storage_t& dst);
-  void (*destroy)(details::storage_t& src);
-  R (*invoke)(details::storage_t const& src, Args&&... args);
-
-  static type_descriptor<R, Args...> const*
-  get_empty_func_descriptor() noexcept {
-    constexpr static type_descriptor<R, Args...> result = {
-        [](details::storage_t const&, details::storage_t&) {},
-        [](details::storage_t&, details::storage_t&) {},
-        [](details::storage_t&) {},
-        [](details::storage_t const&, Args&&...) -> R {
-          throw bad_function_call{};
-        }};
+template <typename T, typename Storage>
+constexpr auto get_move_thunk() noexcept -> void (*)(Storage&, Storage&) {
+  if constexpr (trivially_small<T, Storage> || !fits_small<T, Storage>) {
+    return &trivial_move<Storage>;
+  } else {
+    return [](Storage& src, Storage& dst) {
+      new (&dst) T(std::move(*small_cast<T>(src)));
+      small_cast<T>(src)->~T();
+    };
+  }
+}
 
-    return &result;
+template <typename T, typename Storage>
+constexpr auto get_destroy_thunk() noexcept -> void (*)(Storage&) {
+  if constexpr (trivially_small<T, Storage>) {
+    return &trivial_destroy<Storage>;
+  } else {
+    return [](Storage& src) {
+      if constexpr (fits_small<T, Storage>) {
+        small_cast<T>(src)->~T();
+      } else {
+        big_delete(big_cast<T>(src));
+      }
+    };
   }
+}
 
-  template <typename T>
-  static type_descriptor<R, Args...> const* get_descriptor() noexcept {
-    constexpr static type_descriptor<R, Args...> result = {
-        [](details::storage_t const& src, details::storage_t& dst) {
-          if constexpr (details::fits_small<T>) {
-            new (&dst) T(*details::small_cast<T>(src));
+template <typename Storage>
+inline constexpr storage_manager<Storage> empty_manager = {
+    [](Storage const&, Storage&) {}, [](Storage&, Storage&) {},
+    [](Storage&) {}};
+
+template <typename Storage>
+inline constexpr storage_manager<Storage> trivial_manager = {
+    &trivial_copy<Storage>, &trivial_move<Storage>, &trivial_destroy<Storage>};
+
+template <typename T, typename Storage, bool Copyable>
+inline constexpr storage_manager<Storage> target_manager = {
+    get_copy_thunk<T, Storage, Copyable>(), get_move_thunk<T, Storage>(),
+    get_destroy_thunk<T, Storage>()};
+
+template <typename T, typename Storage>
+inline constexpr storage_manager<Storage> shared_target_manager = {
+    [](Storage const& src, Storage& dst) {
+      auto ptr = big_cast<shared_target<T>>(src);
+      ptr->refs.fetch_add(1, std::memory_order_relaxed);
+      new (&dst) shared_target<T>*(ptr);
+    },
+    &trivial_move<Storage>,
+    [](Storage& src) {
+      auto ptr = big_cast<shared_target<T>>(src);
+      if (ptr->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        big_delete(ptr);
+      }
+    }};
+
+template <typename T, typename Storage, bool Copyable>
+constexpr storage_manager<Storage> const* get_manager() noexcept {
+  if constexpr (stateless<T>) {
+    return &empty_manager<Storage>;
+  } else if constexpr (trivially_small<T, Storage>) {
+    return &trivial_manager<Storage>;
+  } else {
+    return &target_manager<T, Storage, Copyable>;
+  }
+}
+} // namespace details
+
+template <typename Storage, bool Noexcept, typename R, typename... Args>
+struct type_descriptor {
+
+  using batch_out =
+      std::remove_cvref_t<std::conditional_t<std::is_void_v<R>, void, R>>*;
+
+  details::storage_manager<Storage> const* manager;
+  R (*invoke)(Storage& src, Args&&... args) noexcept(Noexcept);
+  void (*invoke_batch)(Storage& src, size_t n, batch_out out,
+                       std::remove_cvref_t<Args> const*... in)
+      noexcept(Noexcept);
+  std::type_info const& (*type)();
+#ifdef FUNCTION_PROFILE
+  std::atomic<unsigned long long>* call_count;
+  char const* (*type_name)();
+#endif
+
+  static type_descriptor const* get_empty_func_descriptor() noexcept {
+    constexpr static type_descriptor result = {
+        &details::empty_manager<Storage>,
+        [](Storage&, Args&&...) noexcept(Noexcept) -> R {
+          if constexpr (Noexcept) {
+            std::terminate();
           } else {
-            auto ptr = new T(*details::big_cast<T>(src));
-            new (&dst) T*(ptr);
+            throw bad_function_call{};
           }
         },
-        [](details::storage_t& src, details::storage_t& dst) {
-          if constexpr (details::fits_small<T>) {
-            new (&dst) T(std::move(*details::small_cast<T>(src)));
-            details::small_cast<T>(src)->~T();
+        [](Storage&, size_t, batch_out,
+           std::remove_cvref_t<Args> const*...) noexcept(Noexcept) {
+          if constexpr (Noexcept) {
+            std::terminate();
           } else {
-            new (&dst) T*(details::big_cast<T>(src));
+            throw bad_function_call{};
           }
         },
-        [](details::storage_t& src) {
-          if constexpr (details::fits_small<T>) {
-            details::small_cast<T>(src)->~T();
+        []() -> std::type_info const& { return typeid(void); }
+#ifdef FUNCTION_PROFILE
+        ,
+        nullptr, [] { return "(empty)"; }
+#endif
+    };
+
+    return &result;
+  }
+
+  template <typename T, bool Copyable = true>
+  static type_descriptor const* get_descriptor() noexcept {
+    constexpr static type_descriptor result = {
+        details::get_manager<T, Storage, Copyable>(),
+        [](Storage& src, Args&&... args) noexcept(Noexcept) -> R {
+#ifdef FUNCTION_PROFILE
+          details::profile_counter<T>.count.fetch_add(
+              1, std::memory_order_relaxed);
+#endif
+          if constexpr (details::stateless<T>) {
+            return std::invoke(T{}, std::forward<Args>(args)...);
           } else {
-            delete details::big_cast<T>(src);
+            return std::invoke(*details::cast<T>(src),
+                               std::forward<Args>(args)...);
           }
         },
-        [](details::storage_t const& src, Args&&... args) -> R {
-          return details::cast<T>(src)->operator()(std::forward<Args>(args)...);
-        }};
+        [](Storage& src, size_t n, batch_out out,
+           std::remove_cvref_t<Args> const*... in) noexcept(Noexcept) {
+#ifdef FUNCTION_PROFILE
+          details::profile_counter<T>.count.fetch_add(
+              n, std::memory_order_relaxed);
+#endif
+          if constexpr (!std::is_reference_v<R> &&
+                        std::is_invocable_r_v<
+                            R, T&,
+                            std::remove_cvref_t<Args> const&...>) {
+            if constexpr (details::stateless<T>) {
+              for (size_t i = 0; i != n; ++i) {
+                if constexpr (std::is_void_v<R>) {
+                  std::invoke(T{}, in[i]...);
+                } else {
+                  out[i] = std::invoke(T{}, in[i]...);
+                }
+              }
+            } else {
+              T& target = *details::cast<T>(src);
+              for (size_t i = 0; i != n; ++i) {
+                if constexpr (std::is_void_v<R>) {
+                  std::invoke(target, in[i]...);
+                } else {
+                  out[i] = std::invoke(target, in[i]...);
+                }
+              }
+            }
+          } else if constexpr (!std::is_reference_v<R> &&
+                               (std::is_copy_constructible_v<
+                                    std::remove_cvref_t<Args>> &&
+                                ...) &&
+                               std::is_invocable_r_v<
+                                   R, T&, std::remove_cvref_t<Args>...>) {
+            // The target consumes its arguments (e.g. takes them by rvalue
+            // reference); feed it a fresh copy per element.
+            if constexpr (details::stateless<T>) {
+              for (size_t i = 0; i != n; ++i) {
+                if constexpr (std::is_void_v<R>) {
+                  std::invoke(T{}, std::remove_cvref_t<Args>(in[i])...);
+                } else {
+                  out[i] =
+                      std::invoke(T{}, std::remove_cvref_t<Args>(in[i])...);
+                }
+              }
+            } else {
+              T& target = *details::cast<T>(src);
+              for (size_t i = 0; i != n; ++i) {
+                if constexpr (std::is_void_v<R>) {
+                  std::invoke(target, std::remove_cvref_t<Args>(in[i])...);
+                } else {
+                  out[i] = std::invoke(target,
+                                       std::remove_cvref_t<Args>(in[i])...);
+                }
+              }
+            }
+          } else {
+            // Refuse loudly: a silent no-op would hand back an unmodified
+            // output span as if it were the result.
+            if constexpr (Noexcept) {
+              std::terminate();
+            } else {
+              throw bad_function_call{};
+            }
+          }
+        },
+        []() -> std::type_info const& { return typeid(T); }
+#ifdef FUNCTION_PROFILE
+        ,
+        &details::profile_counter<T>.count, [] { return typeid(T).name(); }
+#endif
+    };
 
     return &result;
   }
+
+  template <typename T>
+  static type_descriptor const* get_shared_descriptor() noexcept {
+    if constexpr (details::fits_small<T, Storage>) {
+      return get_descriptor<T, true>();
+    } else {
+      constexpr static type_descriptor result = {
+          &details::shared_target_manager<T, Storage>,
+          [](Storage& src, Args&&... args) noexcept(Noexcept) -> R {
+#ifdef FUNCTION_PROFILE
+            details::profile_counter<T>.count.fetch_add(
+                1, std::memory_order_relaxed);
+#endif
+            return std::invoke(
+                details::big_cast<details::shared_target<T>>(src)->value,
+                std::forward<Args>(args)...);
+          },
+          [](Storage& src, size_t n, batch_out out,
+             std::remove_cvref_t<Args> const*... in) noexcept(Noexcept) {
+#ifdef FUNCTION_PROFILE
+            details::profile_counter<T>.count.fetch_add(
+                n, std::memory_order_relaxed);
+#endif
+            if constexpr (!std::is_reference_v<R> &&
+                          std::is_invocable_r_v<
+                              R, T&,
+                              std::remove_cvref_t<Args> const&...>) {
+              T& target =
+                  details::big_cast<details::shared_target<T>>(src)->value;
+              for (size_t i = 0; i != n; ++i) {
+                if constexpr (std::is_void_v<R>) {
+                  std::invoke(target, in[i]...);
+                } else {
+                  out[i] = std::invoke(target, in[i]...);
+                }
+              }
+            } else if constexpr (!std::is_reference_v<R> &&
+                                 (std::is_copy_constructible_v<
+                                      std::remove_cvref_t<Args>> &&
+                                  ...) &&
+                                 std::is_invocable_r_v<
+                                     R, T&, std::remove_cvref_t<Args>...>) {
+              T& target =
+                  details::big_cast<details::shared_target<T>>(src)->value;
+              for (size_t i = 0; i != n; ++i) {
+                if constexpr (std::is_void_v<R>) {
+                  std::invoke(target, std::remove_cvref_t<Args>(in[i])...);
+                } else {
+                  out[i] = std::invoke(target,
+                                       std::remove_cvref_t<Args>(in[i])...);
+                }
+              }
+            } else {
+              if constexpr (Noexcept) {
+                std::terminate();
+              } else {
+                throw bad_function_call{};
+              }
+            }
+          },
+          []() -> std::type_info const& { return typeid(T); }
+#ifdef FUNCTION_PROFILE
+          ,
+          &details::profile_counter<T>.count, [] { return typeid(T).name(); }
+#endif
+      };
+
+      return &result;
+    }
+  }
 };
 
-template <typename F>
-struct function;
+namespace details {
+template <bool Copyable, bool Noexcept, size_t Capacity, size_t Align,
+          typename R, typename... Args>
+struct function_base {
+  static_assert(Capacity >= sizeof(void*),
+                "function buffer must be able to hold a pointer");
+  static_assert(Align % alignof(void*) == 0,
+                "function buffer must be aligned at least as a pointer");
 
-template <typename R, typename... Args>
-struct function<R(Args...)> {
-  function() noexcept
-      : desc(type_descriptor<R, Args...>::get_empty_func_descriptor()) {}
+private:
+  using storage_t = details::storage<Capacity, Align>;
+  using descriptor = type_descriptor<storage_t, Noexcept, R, Args...>;
 
-  function(function const& other) : desc(other.desc) {
-    other.desc->copy(other.storage, this->storage);
+public:
+  function_base() noexcept
+      : desc(descriptor::get_empty_func_descriptor()), invoke(desc->invoke) {}
+
+  function_base(function_base const& other)
+    requires Copyable
+      : desc(other.desc), invoke(other.invoke) {
+    other.desc->manager->copy(other.storage, this->storage);
   }
 
-  function(function&& other) : desc(other.desc) {
-    other.desc = type_descriptor<R, Args...>::get_empty_func_descriptor();
-    desc->move(other.storage, this->storage);
+  function_base(function_base&& other) noexcept
+      : desc(other.desc), invoke(other.invoke) {
+    other.desc = descriptor::get_empty_func_descriptor();
+    other.invoke = other.desc->invoke;
+    desc->manager->move(other.storage, this->storage);
   }
 
   template <typename T>
-  function(T val)
-      : desc(type_descriptor<R, Args...>::template get_descriptor<T>()) {
-    if constexpr (details::fits_small<T>) {
-      new (&storage) T(std::move(val));
+  function_base(T val) : function_base() {
+    if constexpr (adoptable<T>) {
+      adopt(val);
     } else {
-      auto ptr = new T(std::move(val));
-      new (&storage) T*(ptr);
+      emplace<T>(std::move(val));
     }
   }
 
-  function& operator=(function const& other) {
+  template <typename T, typename... CtorArgs>
+  function_base(std::in_place_type_t<T>, CtorArgs&&... ctor_args)
+      : function_base() {
+    emplace<T>(std::forward<CtorArgs>(ctor_args)...);
+  }
+
+  function_base& operator=(function_base const& other)
+    requires Copyable
+  {
     if (this != &other) {
-      details::storage_t buf;
-      other.desc->copy(other.storage, buf);
-      this->desc->destroy(this->storage);
+      storage_t buf;
+      other.desc->manager->copy(other.storage, buf);
+      this->desc->manager->destroy(this->storage);
       desc = other.desc;
-      storage = buf;
+      invoke = other.invoke;
+      desc->manager->move(buf, storage);
     }
     return *this;
   }
 
-  function& operator=(function&& other) noexcept {
+  function_base& operator=(function_base&& other) noexcept {
     if (this != &other) {
-      desc->destroy(storage);
+      desc->manager->destroy(storage);
       desc = other.desc;
-      desc->move(other.storage, this->storage);
-      other.desc = type_descriptor<R, Args...>::get_empty_func_descriptor();
+      invoke = other.invoke;
+      desc->manager->move(other.storage, this->storage);
+      other.desc = descriptor::get_empty_func_descriptor();
+      other.invoke = other.desc->invoke;
     }
     return *this;
   }
 
-  ~function() {
-    desc->destroy(storage);
+  ~function_base() {
+    desc->manager->destroy(storage);
+  }
+
+  template <typename T>
+    requires(!std::is_same_v<T, function_base>)
+  function_base& operator=(T val) {
+    if constexpr (std::is_move_assignable_v<T>) {
+      if (desc == descriptor::template get_descriptor<T, Copyable>()) {
+        *details::cast<T>(storage) = std::move(val);
+        return *this;
+      }
+    }
+    // Destroying the old target first hands its block to the thread-local
+    // freelist, so a new big target of the same size class gets the block
+    // straight back instead of a fresh allocation. Only worth giving up the
+    // strong guarantee for when constructing the new target cannot throw.
+    if constexpr (!adoptable<T> && !details::fits_small<T, storage_t> &&
+                  std::is_nothrow_move_constructible_v<T>) {
+      emplace<T>(std::move(val));
+      return *this;
+    } else {
+      return *this = function_base(std::move(val));
+    }
+  }
+
+  template <typename T, typename... CtorArgs>
+  T& emplace(CtorArgs&&... ctor_args) {
+    static_assert(!Noexcept ||
+                      std::is_nothrow_invocable_r_v<R, T&, Args...>,
+                  "a noexcept function requires a nothrow-invocable target");
+    desc->manager->destroy(storage);
+    desc = descriptor::get_empty_func_descriptor();
+    invoke = desc->invoke;
+
+    T* ptr;
+    if constexpr (details::fits_small<T, storage_t>) {
+      ptr = new (&storage) T(std::forward<CtorArgs>(ctor_args)...);
+    } else {
+      ptr = details::big_new<T>(std::forward<CtorArgs>(ctor_args)...);
+      new (&storage) T*(ptr);
+    }
+    desc = descriptor::template get_descriptor<T, Copyable>();
+    invoke = desc->invoke;
+    return *ptr;
+  }
+
+  void swap(function_base& other) noexcept {
+    if (this == &other) {
+      return;
+    }
+
+    storage_t buf;
+    desc->manager->move(storage, buf);
+    other.desc->manager->move(other.storage, storage);
+    desc->manager->move(buf, other.storage);
+    std::swap(desc, other.desc);
+    std::swap(invoke, other.invoke);
+  }
+
+  friend void swap(function_base& lhs, function_base& rhs) noexcept {
+    lhs.swap(rhs);
   }
 
   explicit operator bool() const noexcept {
-    return type_descriptor<R, Args...>::get_empty_func_descriptor() != desc;
+    return descriptor::get_empty_func_descriptor() != desc;
+  }
+
+  R operator()(Args... args) const noexcept(Noexcept) {
+    return invoke(storage, std::forward<Args>(args)...);
+  }
+
+  R invoke_unchecked(Args... args) const noexcept(Noexcept) {
+    assert(static_cast<bool>(*this));
+    return invoke(storage, std::forward<Args>(args)...);
   }
 
-  R operator()(Args&&... args) const {
-    return desc->invoke(storage, std::forward<Args>(args)...);
+  template <typename R2>
+  R2 invoke_r(Args... args) const noexcept(Noexcept) {
+    if constexpr (std::is_void_v<R2>) {
+      invoke(storage, std::forward<Args>(args)...);
+    } else {
+      return invoke(storage, std::forward<Args>(args)...);
+    }
+  }
+
+  void for_each(std::span<std::remove_cvref_t<Args> const>... in) const
+      noexcept(Noexcept)
+    requires(std::is_void_v<R> && sizeof...(Args) > 0)
+  {
+    size_t const sizes[] = {in.size()...};
+    size_t n = sizes[0];
+    for (size_t size : sizes) {
+      assert(size == n);
+      (void)size;
+    }
+    desc->invoke_batch(storage, n, nullptr, in.data()...);
+  }
+
+  void map_over(std::span<std::remove_cvref_t<Args> const>... in,
+                std::span<R> out) const noexcept(Noexcept)
+    requires(!std::is_void_v<R> && !std::is_reference_v<R>)
+  {
+    size_t n = out.size();
+    assert(((in.size() == n) && ...));
+    desc->invoke_batch(storage, n, out.data(), in.data()...);
   }
 
   template <typename T>
   T* target() noexcept {
-    if (type_descriptor<R, Args...>::template get_descriptor<T>() == desc) {
+    if (matches_target<T>()) {
       return details::cast<T>(storage);
     }
 
@@ -182,7 +743,7 @@ struct function<R(Args...)> {
 
   template <typename T>
   T const* target() const noexcept {
-    if (type_descriptor<R, Args...>::template get_descriptor<T>() == desc) {
+    if (matches_target<T>()) {
       return details::cast<T>(storage);
     }
 
@@ -190,6 +751,303 @@ struct function<R(Args...)> {
   }
 
 private:
-  details::storage_t storage;
-  type_descriptor<R, Args...> const* desc;
+  template <bool, bool, size_t, size_t, typename, typename...>
+  friend struct function_base;
+
+  // A wrapper with the same storage and signature shares our descriptor
+  // type, so its target can be taken over instead of re-erasing the whole
+  // wrapper. A copyable function must not adopt from a move-only one: the
+  // source descriptor carries no copy thunk.
+  template <typename T>
+  constexpr static bool adoptable =
+      std::is_base_of_v<
+          function_base<true, Noexcept, Capacity, Align, R, Args...>, T> ||
+      (!Copyable &&
+       std::is_base_of_v<
+           function_base<false, Noexcept, Capacity, Align, R, Args...>, T>);
+
+  // An adopted target answers to the descriptor it was erased with, which
+  // may be the copyable variant even inside a move-only wrapper; a target
+  // erased in another DSO answers to that DSO's descriptor instantiation.
+  // The address compare is the fast path, typeid equality the fallback
+  // (the empty descriptor reports typeid(void) and never matches).
+  template <typename T>
+  bool matches_target() const noexcept {
+    if (descriptor::template get_descriptor<T, Copyable>() == desc) {
+      return true;
+    }
+    if constexpr (!Copyable && std::is_copy_constructible_v<T>) {
+      if (descriptor::template get_descriptor<T, true>() == desc) {
+        return true;
+      }
+    }
+    return desc->type() == typeid(T);
+  }
+
+  template <bool C2>
+  void adopt(
+      function_base<C2, Noexcept, Capacity, Align, R, Args...>& other) noexcept {
+    desc = other.desc;
+    invoke = other.invoke;
+    desc->manager->move(other.storage, storage);
+    other.desc = descriptor::get_empty_func_descriptor();
+    other.invoke = other.desc->invoke;
+  }
+
+  mutable storage_t storage;
+  descriptor const* desc;
+  R (*invoke)(storage_t& src, Args&&... args) noexcept(Noexcept);
+};
+} // namespace details
+
+template <typename F, size_t Capacity = sizeof(void*),
+          size_t Align = alignof(void*)>
+struct function;
+
+template <typename R, typename... Args, size_t Capacity, size_t Align>
+struct function<R(Args...), Capacity, Align>
+    : details::function_base<true, false, Capacity, Align, R, Args...> {
+  using details::function_base<true, false, Capacity, Align, R,
+                               Args...>::function_base;
+  using details::function_base<true, false, Capacity, Align, R,
+                               Args...>::operator=;
+};
+
+template <typename R, typename... Args, size_t Capacity, size_t Align>
+struct function<R(Args...) noexcept, Capacity, Align>
+    : details::function_base<true, true, Capacity, Align, R, Args...> {
+  using details::function_base<true, true, Capacity, Align, R,
+                               Args...>::function_base;
+  using details::function_base<true, true, Capacity, Align, R,
+                               Args...>::operator=;
+};
+
+template <typename F, size_t Capacity = sizeof(void*),
+          size_t Align = alignof(void*)>
+struct unique_function;
+
+template <typename R, typename... Args, size_t Capacity, size_t Align>
+struct unique_function<R(Args...), Capacity, Align>
+    : details::function_base<false, false, Capacity, Align, R, Args...> {
+  using details::function_base<false, false, Capacity, Align, R,
+                               Args...>::function_base;
+  using details::function_base<false, false, Capacity, Align, R,
+                               Args...>::operator=;
+};
+
+namespace details {
+template <typename F>
+struct target_traits;
+
+template <typename R, typename... As>
+struct target_traits<R (*)(As...)> {
+  using signature = R(As...);
+};
+
+template <typename R, typename... As>
+struct target_traits<R (*)(As...) noexcept> {
+  using signature = R(As...) noexcept;
+};
+
+template <typename R, typename C, typename... As>
+struct target_traits<R (C::*)(As...)> {
+  using object_t = C;
+  using signature = R(As...);
+};
+
+template <typename R, typename C, typename... As>
+struct target_traits<R (C::*)(As...) const> {
+  using object_t = C const;
+  using signature = R(As...);
+};
+
+template <typename R, typename C, typename... As>
+struct target_traits<R (C::*)(As...) noexcept> {
+  using object_t = C;
+  using signature = R(As...) noexcept;
+};
+
+template <typename R, typename C, typename... As>
+struct target_traits<R (C::*)(As...) const noexcept> {
+  using object_t = C const;
+  using signature = R(As...) noexcept;
+};
+
+template <auto Fn>
+struct bound_member {
+  typename target_traits<decltype(Fn)>::object_t* obj;
+
+  template <typename... As>
+  decltype(auto) operator()(As&&... as) const
+      noexcept(std::is_nothrow_invocable_v<decltype(Fn), decltype(obj),
+                                           As...>) {
+    return std::invoke(Fn, obj, std::forward<As>(as)...);
+  }
+};
+
+template <auto Fn>
+struct bound_free {
+  template <typename... As>
+  decltype(auto) operator()(As&&... as) const
+      noexcept(std::is_nothrow_invocable_v<decltype(Fn), As...>) {
+    return std::invoke(Fn, std::forward<As>(as)...);
+  }
+};
+
+template <typename F, typename... As>
+struct bound_stored {
+  template <typename... CtorArgs>
+  explicit bound_stored(F fn, CtorArgs&&... ctor_args)
+      : fn(std::move(fn)), args(std::forward<CtorArgs>(ctor_args)...) {}
+
+  decltype(auto) operator()() {
+    return std::apply(fn, args);
+  }
+
+  F fn;
+  std::tuple<As...> args;
+};
+} // namespace details
+
+template <auto Fn>
+auto make_function(typename details::target_traits<decltype(Fn)>::object_t* obj) {
+  using signature = typename details::target_traits<decltype(Fn)>::signature;
+  return function<signature>(details::bound_member<Fn>{obj});
+}
+
+template <auto Fn>
+auto make_function() {
+  using signature = typename details::target_traits<decltype(Fn)>::signature;
+  return function<signature>(details::bound_free<Fn>{});
+}
+
+template <size_t Capacity = sizeof(void*), size_t Align = alignof(void*),
+          typename F, typename... As>
+auto bind_stored(F fn, As&&... args) {
+  using bound = details::bound_stored<F, std::decay_t<As>...>;
+  using result = std::invoke_result_t<F&, std::decay_t<As>&...>;
+  return function<result(), Capacity, Align>(std::in_place_type<bound>,
+                                             std::move(fn),
+                                             std::forward<As>(args)...);
+}
+
+#ifdef FUNCTION_PROFILE
+inline void function_profile_dump(std::FILE* out = stderr) {
+  details::profile_registry::instance().dump(out);
+}
+#endif
+
+template <typename F, size_t Capacity = sizeof(void*),
+          size_t Align = alignof(void*)>
+struct shared_function;
+
+template <typename R, typename... Args, size_t Capacity, size_t Align>
+struct shared_function<R(Args...), Capacity, Align> {
+private:
+  using storage_t = details::storage<Capacity, Align>;
+  using descriptor = type_descriptor<storage_t, false, R, Args...>;
+
+public:
+  shared_function() noexcept
+      : desc(descriptor::get_empty_func_descriptor()), invoke(desc->invoke) {}
+
+  shared_function(shared_function const& other)
+      : desc(other.desc), invoke(other.invoke) {
+    other.desc->manager->copy(other.storage, this->storage);
+  }
+
+  shared_function(shared_function&& other) noexcept
+      : desc(other.desc), invoke(other.invoke) {
+    other.desc = descriptor::get_empty_func_descriptor();
+    other.invoke = other.desc->invoke;
+    desc->manager->move(other.storage, this->storage);
+  }
+
+  template <typename T>
+  shared_function(T val)
+      : desc(descriptor::template get_shared_descriptor<T>()),
+        invoke(desc->invoke) {
+    if constexpr (details::fits_small<T, storage_t>) {
+      new (&storage) T(std::move(val));
+    } else {
+      auto ptr = details::big_new<details::shared_target<T>>(std::move(val));
+      new (&storage) details::shared_target<T>*(ptr);
+    }
+  }
+
+  shared_function& operator=(shared_function const& other) {
+    if (this != &other) {
+      storage_t buf;
+      other.desc->manager->copy(other.storage, buf);
+      desc->manager->destroy(storage);
+      desc = other.desc;
+      invoke = other.invoke;
+      desc->manager->move(buf, storage);
+    }
+    return *this;
+  }
+
+  shared_function& operator=(shared_function&& other) noexcept {
+    if (this != &other) {
+      desc->manager->destroy(storage);
+      desc = other.desc;
+      invoke = other.invoke;
+      desc->manager->move(other.storage, this->storage);
+      other.desc = descriptor::get_empty_func_descriptor();
+      other.invoke = other.desc->invoke;
+    }
+    return *this;
+  }
+
+  ~shared_function() {
+    desc->manager->destroy(storage);
+  }
+
+  explicit operator bool() const noexcept {
+    return descriptor::get_empty_func_descriptor() != desc;
+  }
+
+  R operator()(Args... args) const {
+    return invoke(storage, std::forward<Args>(args)...);
+  }
+
+  template <typename T>
+  T const* target() const noexcept {
+    if (descriptor::template get_shared_descriptor<T>() == desc ||
+        desc->type() == typeid(T)) {
+      if constexpr (details::fits_small<T, storage_t>) {
+        return details::small_cast<T>(storage);
+      } else {
+        return &details::big_cast<details::shared_target<T>>(storage)->value;
+      }
+    }
+
+    return nullptr;
+  }
+
+private:
+  mutable storage_t storage;
+  descriptor const* desc;
+  R (*invoke)(storage_t& src, Args&&... args);
+};
+
+template <typename F>
+struct function_ref;
+
+template <typename R, typename... Args>
+struct function_ref<R(Args...)> {
+  template <typename T>
+  function_ref(T& val) noexcept
+      : obj(details::erase_address(val)),
+        invoke([](void* obj, Args&&... args) -> R {
+          return (*reinterpret_cast<T*>(obj))(std::forward<Args>(args)...);
+        }) {}
+
+  R operator()(Args... args) const {
+    return invoke(obj, std::forward<Args>(args)...);
+  }
+
+private:
+  void* obj;
+  R (*invoke)(void* obj, Args&&... args);
 };
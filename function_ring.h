@@ -0,0 +1,133 @@
+#pragma once
+#include "function.h"
+
+template <typename F, size_t SlotBytes = 64, size_t N = 1024>
+struct function_ring;
+
+template <typename R, typename... Args, size_t SlotBytes, size_t N>
+struct function_ring<R(Args...), SlotBytes, N> {
+  static_assert(N >= 2 && (N & (N - 1)) == 0,
+                "ring capacity must be a power of two");
+  static_assert(SlotBytes >= sizeof(void*),
+                "ring slot must be able to hold a pointer");
+
+private:
+  using storage_t = details::storage<SlotBytes, alignof(void*)>;
+  using descriptor = type_descriptor<storage_t, false, R, Args...>;
+
+public:
+  function_ring() noexcept {
+    for (size_t i = 0; i != N; ++i) {
+      slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  function_ring(function_ring const&) = delete;
+  function_ring& operator=(function_ring const&) = delete;
+
+  ~function_ring() {
+    size_t pos = head.load(std::memory_order_relaxed);
+    while (true) {
+      slot& s = slots[pos & (N - 1)];
+      if (s.sequence.load(std::memory_order_relaxed) != pos + 1) {
+        break;
+      }
+      s.desc->manager->destroy(s.storage);
+      ++pos;
+    }
+  }
+
+  template <typename T>
+  bool try_push(T val) {
+    // A big target is allocated up front so that everything after the slot
+    // is claimed is noexcept; a small target must move in without throwing.
+    T* big = nullptr;
+    if constexpr (!details::fits_small<T, storage_t>) {
+      big = details::big_new<T>(std::move(val));
+    } else {
+      static_assert(std::is_nothrow_move_constructible_v<T>,
+                    "an in-slot target must be nothrow-move-constructible");
+    }
+
+    size_t pos = tail.load(std::memory_order_relaxed);
+    while (true) {
+      slot& s = slots[pos & (N - 1)];
+      size_t seq = s.sequence.load(std::memory_order_acquire);
+      intptr_t diff =
+          static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (tail.compare_exchange_weak(pos, pos + 1,
+                                       std::memory_order_relaxed)) {
+          if constexpr (details::fits_small<T, storage_t>) {
+            new (&s.storage) T(std::move(val));
+          } else {
+            new (&s.storage) T*(big);
+          }
+          s.desc = descriptor::template get_descriptor<T, false>();
+          s.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        if constexpr (!details::fits_small<T, storage_t>) {
+          details::big_delete(big);
+        }
+        return false;
+      } else {
+        pos = tail.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool try_invoke(Args... args) {
+    size_t pos = head.load(std::memory_order_relaxed);
+    while (true) {
+      slot& s = slots[pos & (N - 1)];
+      size_t seq = s.sequence.load(std::memory_order_acquire);
+      intptr_t diff =
+          static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (head.compare_exchange_weak(pos, pos + 1,
+                                       std::memory_order_relaxed)) {
+          try {
+            s.desc->invoke(s.storage, static_cast<Args>(args)...);
+          } catch (...) {
+            release(s, pos);
+            throw;
+          }
+          release(s, pos);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = head.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool empty() const noexcept {
+    return size() == 0;
+  }
+
+  size_t size() const noexcept {
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t h = head.load(std::memory_order_relaxed);
+    return t - h;
+  }
+
+private:
+  struct slot {
+    std::atomic<size_t> sequence;
+    descriptor const* desc;
+    storage_t storage;
+  };
+
+  void release(slot& s, size_t pos) noexcept {
+    s.desc->manager->destroy(s.storage);
+    s.sequence.store(pos + N, std::memory_order_release);
+  }
+
+  alignas(64) std::atomic<size_t> head{0};
+  alignas(64) std::atomic<size_t> tail{0};
+  alignas(64) slot slots[N];
+};
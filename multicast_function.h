@@ -0,0 +1,111 @@
+#pragma once
+#include "function.h"
+#include <vector>
+
+template <typename F, size_t Capacity = sizeof(void*),
+          size_t Align = alignof(void*)>
+struct multicast_function;
+
+template <typename... Args, size_t Capacity, size_t Align>
+struct multicast_function<void(Args...), Capacity, Align> {
+private:
+  using storage_t = details::storage<Capacity, Align>;
+  using descriptor = type_descriptor<storage_t, false, void, Args...>;
+
+public:
+  multicast_function() noexcept = default;
+
+  multicast_function(multicast_function const&) = delete;
+  multicast_function& operator=(multicast_function const&) = delete;
+
+  multicast_function(multicast_function&&) noexcept = default;
+
+  multicast_function& operator=(multicast_function&& other) noexcept {
+    if (this != &other) {
+      clear();
+      groups = std::move(other.groups);
+    }
+    return *this;
+  }
+
+  ~multicast_function() {
+    clear();
+  }
+
+  template <typename T>
+  void add(T val) {
+    group& g = find_group(descriptor::template get_descriptor<T, false>());
+    if (g.size == g.capacity) {
+      grow(g);
+    }
+
+    storage_t& slot = g.slots[g.size];
+    if constexpr (details::fits_small<T, storage_t>) {
+      new (&slot) T(std::move(val));
+    } else {
+      auto ptr = details::big_new<T>(std::move(val));
+      new (&slot) T*(ptr);
+    }
+    ++g.size;
+  }
+
+  void operator()(Args... args) const {
+    for (group const& g : groups) {
+      auto invoke = g.desc->invoke;
+      for (size_t i = 0; i != g.size; ++i) {
+        invoke(g.slots[i], static_cast<Args>(args)...);
+      }
+    }
+  }
+
+  void clear() noexcept {
+    for (group& g : groups) {
+      for (size_t i = 0; i != g.size; ++i) {
+        g.desc->manager->destroy(g.slots[i]);
+      }
+    }
+    groups.clear();
+  }
+
+  size_t size() const noexcept {
+    size_t result = 0;
+    for (group const& g : groups) {
+      result += g.size;
+    }
+    return result;
+  }
+
+  bool empty() const noexcept {
+    return groups.empty();
+  }
+
+private:
+  struct group {
+    descriptor const* desc;
+    std::unique_ptr<storage_t[]> slots = nullptr;
+    size_t size = 0;
+    size_t capacity = 0;
+  };
+
+  group& find_group(descriptor const* desc) {
+    for (group& g : groups) {
+      if (g.desc == desc) {
+        return g;
+      }
+    }
+    groups.push_back(group{desc});
+    return groups.back();
+  }
+
+  static void grow(group& g) {
+    size_t new_capacity = g.capacity == 0 ? 4 : g.capacity * 2;
+    auto new_slots = std::make_unique<storage_t[]>(new_capacity);
+    for (size_t i = 0; i != g.size; ++i) {
+      g.desc->manager->move(g.slots[i], new_slots[i]);
+    }
+    g.slots = std::move(new_slots);
+    g.capacity = new_capacity;
+  }
+
+  std::vector<group> groups;
+};
@@ -1,5 +1,10 @@
+#include "atomic_function.h"
 #include "function.h"
+#include "function_ring.h"
+#include "multicast_function.h"
+#include <array>
 #include <gtest/gtest.h>
+#include <thread>
 
 TEST(function_test, default_ctor) {
   function<void()> x;
@@ -414,6 +419,987 @@ TEST(function_test, target) {
   EXPECT_NE(nullptr, std::as_const(f).target<bar>());
 }
 
+struct fat_func {
+  fat_func(int value) noexcept : value(value) {
+    std::fill(std::begin(payload), std::end(payload), value);
+  }
+
+  int operator()() const {
+    return value;
+  }
+
+  int get_value() const {
+    return value;
+  }
+
+private:
+  int value;
+  int payload[10];
+};
+
+TEST(function_test, custom_capacity) {
+  function<int(), 48> f = fat_func(42);
+  EXPECT_EQ(42, f());
+  EXPECT_EQ(42, f.target<fat_func>()->get_value());
+}
+
+TEST(function_test, custom_capacity_stores_inline) {
+  function<int(), 48> f = fat_func(42);
+  void* t = f.target<fat_func>();
+  EXPECT_GE(t, static_cast<void*>(&f));
+  EXPECT_LT(t, static_cast<void*>(&f + 1));
+}
+
+TEST(function_test, custom_capacity_copy_move) {
+  function<int(), 48> f = fat_func(42);
+  function<int(), 48> g = f;
+  EXPECT_EQ(42, g());
+  function<int(), 48> h = std::move(g);
+  EXPECT_EQ(42, h());
+}
+
+struct alignas(32) overaligned_func {
+  overaligned_func(int value) noexcept : value(value) {}
+
+  int operator()() const {
+    return value;
+  }
+
+private:
+  int value;
+};
+
+TEST(function_test, custom_alignment) {
+  function<int(), 64, 32> f = overaligned_func(42);
+  EXPECT_EQ(42, f());
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(f.target<overaligned_func>()) % 32);
+}
+
+static_assert(std::is_trivially_copyable_v<function_ref<int()>>);
+static_assert(sizeof(function_ref<int()>) == 2 * sizeof(void*));
+
+TEST(function_ref_test, ctor_func) {
+  auto lambda = [] { return 42; };
+  function_ref<int()> f = lambda;
+  EXPECT_EQ(42, f());
+}
+
+TEST(function_ref_test, arguments) {
+  auto lambda = [](int a, int b) { return a + b; };
+  function_ref<int(int, int)> f = lambda;
+  EXPECT_EQ(42, f(40, 2));
+}
+
+TEST(function_ref_test, references_callable) {
+  int calls = 0;
+  auto lambda = [&calls] { return ++calls; };
+  function_ref<int()> f = lambda;
+  EXPECT_EQ(1, f());
+  EXPECT_EQ(2, f());
+  EXPECT_EQ(2, calls);
+}
+
+TEST(function_ref_test, const_callable) {
+  small_func const func(42);
+  function_ref<int()> f = func;
+  EXPECT_EQ(42, f());
+}
+
+static int free_func() {
+  return 42;
+}
+
+TEST(function_ref_test, free_function) {
+  function_ref<int()> f = free_func;
+  EXPECT_EQ(42, f());
+}
+
+TEST(function_ref_test, copy) {
+  auto lambda = [] { return 42; };
+  function_ref<int()> f = lambda;
+  function_ref<int()> g = f;
+  EXPECT_EQ(42, f());
+  EXPECT_EQ(42, g());
+}
+
+static_assert(!std::is_copy_constructible_v<unique_function<int()>>);
+static_assert(!std::is_copy_assignable_v<unique_function<int()>>);
+static_assert(std::is_move_constructible_v<unique_function<int()>>);
+static_assert(std::is_move_assignable_v<unique_function<int()>>);
+
+TEST(unique_function_test, default_ctor) {
+  unique_function<void()> x;
+  EXPECT_FALSE(static_cast<bool>(x));
+  EXPECT_THROW(x(), bad_function_call);
+}
+
+TEST(unique_function_test, ctor_func) {
+  unique_function<int()> f = [] { return 42; };
+  EXPECT_EQ(42, f());
+}
+
+TEST(unique_function_test, non_copyable_func) {
+  unique_function<int()> f = [p = std::make_unique<int>(42)] { return *p; };
+  EXPECT_EQ(42, f());
+}
+
+TEST(unique_function_test, non_copyable_func_move_ctor) {
+  unique_function<int()> f = [p = std::make_unique<int>(42)] { return *p; };
+  unique_function<int()> g = std::move(f);
+  EXPECT_EQ(42, g());
+}
+
+TEST(unique_function_test, non_copyable_func_assignment_operator_move) {
+  unique_function<int()> f = [p = std::make_unique<int>(42)] { return *p; };
+  unique_function<int()> g;
+  g = std::move(f);
+  EXPECT_EQ(42, g());
+}
+
+TEST(unique_function_test, large_func) {
+  {
+    unique_function<int()> f = large_func(42);
+    EXPECT_EQ(42, f());
+  }
+  large_func::assert_no_instances();
+}
+
+TEST(unique_function_test, target) {
+  unique_function<int()> f = small_func(42);
+  EXPECT_EQ(42, f.target<small_func>()->get_value());
+  EXPECT_EQ(42, std::as_const(f).target<small_func>()->get_value());
+}
+
+static_assert(noexcept(std::declval<function<int() noexcept> const&>()()));
+static_assert(!noexcept(std::declval<function<int()> const&>()()));
+
+TEST(function_test, noexcept_signature) {
+  function<int() noexcept> f = []() noexcept { return 42; };
+  EXPECT_EQ(42, f());
+}
+
+TEST(function_test, noexcept_signature_copy_move) {
+  function<int() noexcept> f = []() noexcept { return 42; };
+  function<int() noexcept> g = f;
+  EXPECT_EQ(42, g());
+  function<int() noexcept> h = std::move(g);
+  EXPECT_EQ(42, h());
+}
+
+TEST(function_test, noexcept_signature_arguments) {
+  function<int(int, int) noexcept> f = [](int a, int b) noexcept {
+    return a + b;
+  };
+  EXPECT_EQ(42, f(40, 2));
+}
+
+TEST(function_test, invoke_unchecked) {
+  function<int(int, int)> f = [](int a, int b) { return a + b; };
+  EXPECT_EQ(42, f.invoke_unchecked(40, 2));
+}
+
+TEST(function_test, invoke_unchecked_large_func) {
+  function<int()> f = large_func(42);
+  EXPECT_EQ(42, f.invoke_unchecked());
+}
+
+TEST(function_test, large_func_block_reuse) {
+  void* first;
+  {
+    function<int()> f = large_func(1);
+    first = f.target<large_func>();
+  }
+  large_func::assert_no_instances();
+  function<int()> g = large_func(2);
+  EXPECT_EQ(first, static_cast<void*>(g.target<large_func>()));
+}
+
+TEST(function_test, pointer_sized_func_stores_inline) {
+  int value = 42;
+  auto lambda = [p = &value] { return *p; };
+  function<int()> f = lambda;
+  EXPECT_EQ(42, f());
+  void* t = f.target<decltype(lambda)>();
+  EXPECT_GE(t, static_cast<void*>(&f));
+  EXPECT_LT(t, static_cast<void*>(&f + 1));
+}
+
+TEST(function_test, small_func_with_pointer_stores_inline) {
+  function<bool()> f = small_func_with_pointer();
+  void* t = f.target<small_func_with_pointer>();
+  EXPECT_GE(t, static_cast<void*>(&f));
+  EXPECT_LT(t, static_cast<void*>(&f + 1));
+  EXPECT_TRUE(f());
+}
+
+struct no_assign_func {
+  no_assign_func(int value) noexcept : value(value) {}
+
+  no_assign_func(no_assign_func const&) noexcept = default;
+  no_assign_func(no_assign_func&&) noexcept = default;
+
+  int operator()() const {
+    return value;
+  }
+
+private:
+  const int value;
+};
+
+static_assert(!std::is_move_assignable_v<no_assign_func>);
+
+TEST(function_test, non_assignable_func) {
+  function<int()> f = no_assign_func(42);
+  function<int()> g;
+  g = f;
+  EXPECT_EQ(42, g());
+  g = std::move(f);
+  EXPECT_EQ(42, g());
+}
+
+static_assert(std::is_nothrow_move_constructible_v<function<int()>>);
+static_assert(std::is_nothrow_move_assignable_v<function<int()>>);
+static_assert(std::is_nothrow_swappable_v<function<int()>>);
+
+TEST(function_test, swap_small) {
+  function<int()> f = small_func(1);
+  function<int()> g = small_func(2);
+  swap(f, g);
+  EXPECT_EQ(2, f());
+  EXPECT_EQ(1, g());
+}
+
+TEST(function_test, swap_large) {
+  function<int()> f = large_func(1);
+  function<int()> g = large_func(2);
+  swap(f, g);
+  EXPECT_EQ(2, f());
+  EXPECT_EQ(1, g());
+}
+
+TEST(function_test, swap_mixed) {
+  function<int()> f = small_func(1);
+  function<int()> g = large_func(2);
+  swap(f, g);
+  EXPECT_EQ(2, f());
+  EXPECT_EQ(1, g());
+  EXPECT_NE(nullptr, f.target<large_func>());
+  EXPECT_NE(nullptr, g.target<small_func>());
+}
+
+TEST(function_test, swap_empty) {
+  function<int()> f = small_func(42);
+  function<int()> g;
+  f.swap(g);
+  EXPECT_FALSE(static_cast<bool>(f));
+  EXPECT_EQ(42, g());
+}
+
+TEST(function_test, swap_self) {
+  function<int()> f = small_func(42);
+  f.swap(f);
+  EXPECT_EQ(42, f());
+}
+
+TEST(function_test, swap_small_func_with_pointer) {
+  function<bool()> f = small_func_with_pointer();
+  function<bool()> g = small_func_with_pointer();
+  swap(f, g);
+  EXPECT_TRUE(f());
+  EXPECT_TRUE(g());
+}
+
+struct two_arg_func {
+  two_arg_func(int a, int b) noexcept : a(a), b(b) {}
+
+  int operator()() const {
+    return a + b;
+  }
+
+private:
+  int a;
+  int b;
+};
+
+TEST(function_test, in_place_ctor) {
+  function<int()> f(std::in_place_type<two_arg_func>, 40, 2);
+  EXPECT_EQ(42, f());
+}
+
+TEST(function_test, in_place_ctor_large) {
+  {
+    function<int()> f(std::in_place_type<large_func>, 42);
+    EXPECT_EQ(42, f());
+  }
+  large_func::assert_no_instances();
+}
+
+TEST(function_test, emplace) {
+  function<int()> f;
+  two_arg_func& target = f.emplace<two_arg_func>(40, 2);
+  EXPECT_EQ(42, f());
+  EXPECT_EQ(&target, f.target<two_arg_func>());
+}
+
+TEST(function_test, emplace_replaces_target) {
+  function<int()> f = large_func(1);
+  f.emplace<small_func>(42);
+  EXPECT_EQ(42, f());
+  large_func::assert_no_instances();
+}
+
+struct move_only_func {
+  explicit move_only_func(int value) : ptr(std::make_unique<int>(value)) {}
+
+  int operator()() const {
+    return *ptr;
+  }
+
+private:
+  std::unique_ptr<int> ptr;
+};
+
+TEST(unique_function_test, emplace) {
+  unique_function<int()> f;
+  f.emplace<move_only_func>(42);
+  EXPECT_EQ(42, f());
+}
+
+TEST(function_test, assignment_from_callable) {
+  function<int()> f;
+  f = small_func(42);
+  EXPECT_EQ(42, f());
+  f = [] { return 5; };
+  EXPECT_EQ(5, f());
+}
+
+TEST(function_test, assignment_same_type_reuses_heap_block) {
+  function<int()> f = large_func(1);
+  void* block = f.target<large_func>();
+  f = large_func(2);
+  EXPECT_EQ(2, f());
+  EXPECT_EQ(block, static_cast<void*>(f.target<large_func>()));
+}
+
+TEST(function_test, assignment_replaces_target_type) {
+  function<int()> f = large_func(1);
+  f = small_func(42);
+  EXPECT_EQ(42, f());
+  large_func::assert_no_instances();
+}
+
+static int mul2(int x) {
+  return 2 * x;
+}
+
+TEST(function_test, function_pointer) {
+  function<int(int)> f = &mul2;
+  EXPECT_EQ(42, f(21));
+  EXPECT_NE(nullptr, f.target<int (*)(int)>());
+}
+
+TEST(function_test, function_pointer_stores_inline) {
+  function<int(int)> f = &mul2;
+  void* t = f.target<int (*)(int)>();
+  EXPECT_GE(t, static_cast<void*>(&f));
+  EXPECT_LT(t, static_cast<void*>(&f + 1));
+}
+
+struct method_holder {
+  int value;
+
+  int get(int add) const {
+    return value + add;
+  }
+};
+
+TEST(function_test, member_function_pointer) {
+  function<int(method_holder&, int)> f = &method_holder::get;
+  method_holder m{40};
+  EXPECT_EQ(42, f(m, 2));
+}
+
+TEST(function_test, member_data_pointer) {
+  function<int(method_holder&)> f = &method_holder::value;
+  method_holder m{42};
+  EXPECT_EQ(42, f(m));
+}
+
+TEST(multicast_function_test, empty) {
+  multicast_function<void(int)> m;
+  EXPECT_TRUE(m.empty());
+  EXPECT_EQ(0, m.size());
+  m(42);
+}
+
+TEST(multicast_function_test, fan_out) {
+  multicast_function<void(int)> m;
+  int sum = 0;
+  int count = 0;
+  m.add([&sum](int x) { sum += x; });
+  m.add([&count](int) { ++count; });
+  m.add([&sum](int x) { sum += 2 * x; });
+  EXPECT_EQ(3, m.size());
+  m(10);
+  EXPECT_EQ(30, sum);
+  EXPECT_EQ(1, count);
+}
+
+struct small_counter_func {
+  int* counter;
+
+  void operator()() const {
+    ++*counter;
+  }
+};
+
+TEST(multicast_function_test, same_type_subscribers_share_group) {
+  multicast_function<void()> m;
+  int calls = 0;
+  small_counter_func inc{&calls};
+  for (int i = 0; i < 10; ++i) {
+    m.add(inc);
+  }
+  m();
+  EXPECT_EQ(10, calls);
+}
+
+TEST(multicast_function_test, large_subscribers_destroyed) {
+  {
+    multicast_function<void()> m;
+    m.add([payload = large_func(1)] { payload(); });
+    m.add([payload = large_func(2)] { payload(); });
+    m();
+  }
+  large_func::assert_no_instances();
+}
+
+TEST(multicast_function_test, clear) {
+  multicast_function<void()> m;
+  int calls = 0;
+  m.add([&calls] { ++calls; });
+  m.clear();
+  EXPECT_TRUE(m.empty());
+  m();
+  EXPECT_EQ(0, calls);
+}
+
+TEST(multicast_function_test, move) {
+  multicast_function<void()> m;
+  int calls = 0;
+  m.add([&calls] { ++calls; });
+  multicast_function<void()> n = std::move(m);
+  n();
+  EXPECT_EQ(1, calls);
+}
+
+TEST(shared_function_test, empty) {
+  shared_function<int()> f;
+  EXPECT_FALSE(static_cast<bool>(f));
+  EXPECT_THROW(f(), bad_function_call);
+}
+
+TEST(shared_function_test, small_func) {
+  shared_function<int()> f = small_func(42);
+  shared_function<int()> g = f;
+  EXPECT_EQ(42, f());
+  EXPECT_EQ(42, g());
+}
+
+TEST(shared_function_test, copy_shares_large_target) {
+  {
+    shared_function<int()> f = large_func(42);
+    shared_function<int()> g = f;
+    EXPECT_EQ(f.target<large_func>(), g.target<large_func>());
+    EXPECT_EQ(42, f());
+    EXPECT_EQ(42, g());
+    f = shared_function<int()>();
+    EXPECT_EQ(42, g());
+  }
+  large_func::assert_no_instances();
+}
+
+struct large_throwing_copy {
+  large_throwing_copy() = default;
+
+  large_throwing_copy(large_throwing_copy&&) noexcept = default;
+
+  large_throwing_copy(large_throwing_copy const&) {
+    throw std::runtime_error("deep copy");
+  }
+
+  int operator()() const {
+    return 42;
+  }
+
+  int payload[1000]{};
+};
+
+TEST(shared_function_test, copy_does_not_deep_copy) {
+  shared_function<int()> f = large_throwing_copy();
+  shared_function<int()> g = f;
+  EXPECT_EQ(42, g());
+}
+
+TEST(shared_function_test, assignment) {
+  shared_function<int()> f = large_func(1);
+  shared_function<int()> g = large_func(2);
+  g = f;
+  EXPECT_EQ(1, g());
+  EXPECT_EQ(f.target<large_func>(), g.target<large_func>());
+}
+
+TEST(shared_function_test, move) {
+  shared_function<int()> f = large_func(42);
+  auto const* t = f.target<large_func>();
+  shared_function<int()> g = std::move(f);
+  EXPECT_FALSE(static_cast<bool>(f));
+  EXPECT_EQ(t, g.target<large_func>());
+  EXPECT_EQ(42, g());
+}
+
+struct counter_widget {
+  int value = 0;
+
+  int add(int x) {
+    value += x;
+    return value;
+  }
+
+  int get() const noexcept {
+    return value;
+  }
+};
+
+TEST(make_function_test, member_function) {
+  counter_widget w;
+  function<int(int)> f = make_function<&counter_widget::add>(&w);
+  EXPECT_EQ(40, f(40));
+  EXPECT_EQ(42, f(2));
+  EXPECT_EQ(42, w.value);
+}
+
+TEST(make_function_test, const_member_function) {
+  counter_widget const w{42};
+  auto f = make_function<&counter_widget::get>(&w);
+  static_assert(std::is_same_v<decltype(f), function<int() noexcept>>);
+  EXPECT_EQ(42, f());
+}
+
+TEST(make_function_test, member_binding_stores_inline) {
+  counter_widget w;
+  auto f = make_function<&counter_widget::add>(&w);
+  function<int(int)>& as_function = f;
+  EXPECT_EQ(42, as_function(42));
+}
+
+TEST(make_function_test, free_function) {
+  auto f = make_function<&mul2>();
+  static_assert(std::is_same_v<decltype(f), function<int(int)>>);
+  EXPECT_EQ(42, f(21));
+}
+
+TEST(function_test, stateless_func) {
+  function<int()> f = [] { return 42; };
+  function<int()> g = f;
+  function<int()> h;
+  h = std::move(g);
+  EXPECT_EQ(42, f());
+  EXPECT_EQ(42, h());
+}
+
+TEST(function_test, stateless_func_target) {
+  function<void()> f = foo();
+  EXPECT_NE(nullptr, f.target<foo>());
+  EXPECT_EQ(nullptr, f.target<bar>());
+}
+
+TEST(atomic_function_test, empty) {
+  atomic_function<int()> f;
+  EXPECT_FALSE(static_cast<bool>(f));
+  EXPECT_THROW(f(), bad_function_call);
+}
+
+TEST(atomic_function_test, store_and_call) {
+  atomic_function<int()> f(small_func(42));
+  EXPECT_EQ(42, f());
+  f.store([] { return 5; });
+  EXPECT_EQ(5, f());
+}
+
+TEST(atomic_function_test, load_snapshot_outlives_store) {
+  atomic_function<int()> f(large_func(42));
+  auto snapshot = f.load();
+  f.store(small_func(5));
+  EXPECT_EQ(42, (*snapshot)());
+  EXPECT_EQ(5, f());
+}
+
+TEST(atomic_function_test, concurrent_store_and_call) {
+  atomic_function<int()> f(small_func(1));
+  std::atomic<bool> stop{false};
+
+  std::thread writer([&] {
+    for (int i = 0; !stop.load(); ++i) {
+      f.store(small_func(i % 2 == 0 ? 1 : 2));
+    }
+  });
+
+  for (int i = 0; i < 10000; ++i) {
+    int result = f();
+    EXPECT_TRUE(result == 1 || result == 2);
+  }
+  stop.store(true);
+  writer.join();
+}
+
+TEST(unique_function_test, adopts_function_target) {
+  function<int()> f = small_func(5);
+
+  unique_function<int()> u = std::move(f);
+  EXPECT_EQ(5, u());
+  EXPECT_NE(nullptr, u.target<small_func>());
+  EXPECT_FALSE(static_cast<bool>(f));
+}
+
+TEST(unique_function_test, adopts_function_target_large) {
+  function<int()> f = large_func(7);
+  large_func const* target = f.target<large_func>();
+
+  unique_function<int()> u = std::move(f);
+  EXPECT_EQ(7, u());
+  EXPECT_EQ(target, u.target<large_func>());
+}
+
+TEST(unique_function_test, adopts_function_target_by_assignment) {
+  unique_function<int()> u = small_func(1);
+
+  u = function<int()>(small_func(2));
+  EXPECT_EQ(2, u());
+  EXPECT_NE(nullptr, u.target<small_func>());
+}
+
+TEST(function_test, mutable_callable) {
+  function<int()> f = [x = 0]() mutable { return ++x; };
+
+  EXPECT_EQ(1, f());
+  EXPECT_EQ(2, f());
+
+  function<int()> copy = f;
+  EXPECT_EQ(3, f());
+  EXPECT_EQ(3, copy());
+}
+
+TEST(function_test, mutable_callable_memoizes) {
+  int computed = 0;
+  function<int(int)> f = [&computed, last_in = -1, last_out = 0](int x) mutable {
+    if (x != last_in) {
+      ++computed;
+      last_in = x;
+      last_out = x * x;
+    }
+    return last_out;
+  };
+
+  EXPECT_EQ(4, f(2));
+  EXPECT_EQ(4, f(2));
+  EXPECT_EQ(9, f(3));
+  EXPECT_EQ(2, computed);
+}
+
+TEST(unique_function_test, mutable_callable_large) {
+  unique_function<int()> f = [data = std::array<int, 100>{}, i = 0]() mutable {
+    data[i] = i;
+    return data[i++];
+  };
+
+  EXPECT_EQ(0, f());
+  EXPECT_EQ(1, f());
+  EXPECT_EQ(2, f());
+}
+
+TEST(function_test, descriptor_type_identity) {
+  using descriptor = type_descriptor<details::storage<8, 8>, false, int>;
+
+  EXPECT_TRUE(descriptor::get_descriptor<small_func>()->type() ==
+              typeid(small_func));
+  EXPECT_TRUE(descriptor::get_descriptor<large_func>()->type() ==
+              typeid(large_func));
+  EXPECT_TRUE(descriptor::get_empty_func_descriptor()->type() ==
+              typeid(void));
+}
+
+TEST(function_test, map_over) {
+  function<int(int)> f = [](int x) { return x * 2; };
+
+  int in[] = {1, 2, 3, 4};
+  int out[4] = {};
+  f.map_over(in, out);
+  EXPECT_EQ(2, out[0]);
+  EXPECT_EQ(4, out[1]);
+  EXPECT_EQ(6, out[2]);
+  EXPECT_EQ(8, out[3]);
+}
+
+TEST(function_test, map_over_large) {
+  int table[1000] = {};
+  table[1] = 10;
+  table[2] = 20;
+  table[3] = 30;
+  function<int(int)> f = [table](int x) { return table[x]; };
+
+  int in[] = {1, 2, 3};
+  int out[3] = {};
+  f.map_over(in, out);
+  EXPECT_EQ(10, out[0]);
+  EXPECT_EQ(20, out[1]);
+  EXPECT_EQ(30, out[2]);
+}
+
+TEST(function_test, map_over_two_args) {
+  function<int(int, int)> f = [](int x, int y) { return x + y; };
+
+  int lhs[] = {1, 2, 3};
+  int rhs[] = {10, 20, 30};
+  int out[3] = {};
+  f.map_over(lhs, rhs, out);
+  EXPECT_EQ(11, out[0]);
+  EXPECT_EQ(22, out[1]);
+  EXPECT_EQ(33, out[2]);
+}
+
+TEST(function_test, map_over_empty) {
+  function<int(int)> f;
+
+  int in[] = {1};
+  int out[1] = {};
+  EXPECT_THROW(f.map_over(in, out), bad_function_call);
+}
+
+TEST(function_test, map_over_rvalue_parameter) {
+  function<int(int)> f = [](int&& x) { return x * 3; };
+
+  int in[] = {1, 2, 3};
+  int out[3] = {};
+  f.map_over(in, out);
+  EXPECT_EQ(3, out[0]);
+  EXPECT_EQ(6, out[1]);
+  EXPECT_EQ(9, out[2]);
+}
+
+TEST(function_test, for_each_not_batchable) {
+  function<void(int&)> f = [](int& x) { ++x; };
+
+  int in[] = {1, 2};
+  EXPECT_THROW(f.for_each(in), bad_function_call);
+}
+
+TEST(function_test, for_each) {
+  int sum = 0;
+  function<void(int)> f = [&sum](int x) { sum += x; };
+
+  int in[] = {1, 2, 3, 4};
+  f.for_each(in);
+  EXPECT_EQ(10, sum);
+}
+
+struct other_large_func {
+  other_large_func(int value) noexcept : value(value) {}
+
+  int operator()() const noexcept {
+    return value;
+  }
+
+private:
+  int value;
+  int payload[900];
+};
+
+TEST(function_test, rebind_large_reuses_block) {
+  function<int()> f = large_func(1);
+  void const* block = f.target<large_func>();
+
+  f = other_large_func(2);
+  EXPECT_EQ(2, f());
+  EXPECT_EQ(block, static_cast<void const*>(f.target<other_large_func>()));
+
+  f = large_func(3);
+  EXPECT_EQ(3, f());
+  EXPECT_EQ(block, static_cast<void const*>(f.target<large_func>()));
+}
+
+int sum3(int a, int b, int c) {
+  return a + b + c;
+}
+
+TEST(bind_stored_test, free_function) {
+  function<int()> f = bind_stored(&sum3, 1, 2, 3);
+  EXPECT_EQ(6, f());
+  EXPECT_EQ(6, f());
+}
+
+TEST(bind_stored_test, member_function) {
+  counter_widget widget;
+  function<int()> f = bind_stored(&counter_widget::add, &widget, 5);
+  EXPECT_EQ(5, f());
+  EXPECT_EQ(10, f());
+  EXPECT_EQ(10, widget.value);
+}
+
+TEST(bind_stored_test, fits_widened_buffer) {
+  auto f = bind_stored<64>(std::plus<int>(), 2, 3);
+
+  auto* target = f.target<details::bound_stored<std::plus<int>, int, int>>();
+  ASSERT_NE(nullptr, target);
+  EXPECT_TRUE(&f <= static_cast<void*>(target) &&
+              static_cast<void*>(target) < &f + 1);
+  EXPECT_EQ(5, f());
+}
+
+TEST(bind_stored_test, large_arguments_single_block) {
+  std::array<int, 100> data{};
+  data[42] = 7;
+
+  function<int()> f =
+      bind_stored([](std::array<int, 100> const& a) { return a[42]; }, data);
+  EXPECT_EQ(7, f());
+
+  function<int()> copy = f;
+  EXPECT_EQ(7, copy());
+}
+
+TEST(function_ring_test, empty) {
+  function_ring<void(), 64, 8> ring;
+  EXPECT_TRUE(ring.empty());
+  EXPECT_FALSE(ring.try_invoke());
+}
+
+TEST(function_ring_test, push_and_invoke) {
+  function_ring<void(), 64, 8> ring;
+  int calls = 0;
+
+  EXPECT_TRUE(ring.try_push([&calls] { ++calls; }));
+  EXPECT_TRUE(ring.try_push([&calls] { calls += 10; }));
+  EXPECT_EQ(2, ring.size());
+
+  EXPECT_TRUE(ring.try_invoke());
+  EXPECT_EQ(1, calls);
+  EXPECT_TRUE(ring.try_invoke());
+  EXPECT_EQ(11, calls);
+  EXPECT_FALSE(ring.try_invoke());
+}
+
+TEST(function_ring_test, full) {
+  function_ring<void(), 64, 2> ring;
+  EXPECT_TRUE(ring.try_push([] {}));
+  EXPECT_TRUE(ring.try_push([] {}));
+  EXPECT_FALSE(ring.try_push([] {}));
+
+  EXPECT_TRUE(ring.try_invoke());
+  EXPECT_TRUE(ring.try_push([] {}));
+}
+
+TEST(function_ring_test, arguments) {
+  function_ring<void(int), 64, 8> ring;
+  int sum = 0;
+
+  ring.try_push([&sum](int x) { sum += x; });
+  ring.try_push([&sum](int x) { sum += x * 2; });
+  ring.try_invoke(5);
+  ring.try_invoke(5);
+  EXPECT_EQ(15, sum);
+}
+
+TEST(function_ring_test, large_target) {
+  {
+    function_ring<void(), 8, 8> ring;
+    int out = 0;
+
+    ring.try_push([x = large_func(7), &out] { out = x.get_value(); });
+    EXPECT_TRUE(ring.try_invoke());
+    EXPECT_EQ(7, out);
+
+    ring.try_push([x = large_func(8), &out] { out = x.get_value(); });
+  }
+  large_func::assert_no_instances();
+}
+
+TEST(function_ring_test, concurrent_producers_consumers) {
+  constexpr size_t per_producer = 1000;
+  constexpr size_t n_producers = 4;
+  constexpr size_t n_consumers = 4;
+
+  function_ring<void(), 64, 128> ring;
+  std::atomic<size_t> sum{0};
+  std::atomic<size_t> consumed{0};
+
+  std::vector<std::thread> threads;
+  for (size_t p = 0; p != n_producers; ++p) {
+    threads.emplace_back([&ring, &sum] {
+      for (size_t i = 0; i != per_producer; ++i) {
+        while (!ring.try_push([&sum, i] { sum += i; })) {
+        }
+      }
+    });
+  }
+  for (size_t c = 0; c != n_consumers; ++c) {
+    threads.emplace_back([&ring, &consumed] {
+      while (consumed.load() < per_producer * n_producers) {
+        if (ring.try_invoke()) {
+          ++consumed;
+        }
+      }
+    });
+  }
+  for (std::thread& t : threads) {
+    t.join();
+  }
+
+  EXPECT_EQ(per_producer * n_producers, consumed.load());
+  EXPECT_EQ(n_producers * (per_producer * (per_producer - 1) / 2),
+            sum.load());
+}
+
+struct count_copies {
+  count_copies() = default;
+
+  count_copies(count_copies const& other) noexcept : copies(other.copies + 1) {}
+
+  count_copies(count_copies&& other) noexcept : copies(other.copies) {}
+
+  int copies = 0;
+};
+
+TEST(function_test, lvalue_argument_binds) {
+  function<int(int)> f = [](int x) { return x + 1; };
+
+  int x = 41;
+  EXPECT_EQ(42, f(x));
+}
+
+TEST(function_test, by_value_argument_copies_once) {
+  function<int(count_copies)> f = [](count_copies c) { return c.copies; };
+
+  count_copies arg;
+  EXPECT_EQ(1, f(arg));
+  EXPECT_EQ(0, f(count_copies()));
+}
+
+TEST(function_test, invoke_r) {
+  function<int()> f = [] { return 42; };
+
+  EXPECT_EQ(42.0, f.invoke_r<double>());
+  f.invoke_r<void>();
+}
+
+TEST(function_ref_test, lvalue_argument_binds) {
+  auto target = [](int x) { return x + 1; };
+  function_ref<int(int)> f = target;
+
+  int x = 41;
+  EXPECT_EQ(42, f(x));
+}
+
 int main(int argc, char* argv[]) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();